@@ -17,6 +17,8 @@
  *
  */
 
+#include <algorithm>
+#include <vector>
 #include "gtest/gtest.h"
 #include "nextpnr.h"
 
@@ -37,6 +39,19 @@ class QuadTreeTest : public ::testing::Test
     QT *qt_;
 };
 
+// Returns the indices of all boxes containing (x, y) in ascending order, for
+// checking point queries against a brute-force reference.
+template <typename BoxT, typename CoordinateT>
+static std::vector<int> brute_force_get(const std::vector<BoxT> &boxes, CoordinateT x, CoordinateT y)
+{
+    std::vector<int> res;
+    for (int i = 0; i < int(boxes.size()); i++) {
+        if (boxes[i].contains(x, y))
+            res.push_back(i);
+    }
+    return res;
+}
+
 // Test that we're doing bound checking correctly.
 TEST_F(QuadTreeTest, insert_bound_checking)
 {
@@ -120,3 +135,123 @@ TEST_F(QuadTreeTest, insert_retrieve_same)
         ASSERT_TRUE(found);
     }
 }
+
+// Test that a fully populated tree answers point queries exactly: all boxes
+// are inserted first, then every query must return precisely the boxes that
+// contain that point.
+TEST_F(QuadTreeTest, insert_all_then_get)
+{
+    auto rng = NEXTPNR_NAMESPACE::DeterministicRNG();
+
+    std::vector<QT::BoundingBox> boxes;
+    rng.rngseed(1);
+    for (int i = 0; i < 20000; i++) {
+        int x0 = rng.rng(width_);
+        int y0 = rng.rng(height_);
+        int w = rng.rng(width_ - x0);
+        int h = rng.rng(height_ - y0);
+        boxes.push_back(QT::BoundingBox(x0, y0, x0 + w / 8, y0 + h / 8));
+    }
+    for (int i = 0; i < int(boxes.size()); i++)
+        ASSERT_TRUE(qt_->insert(boxes[i], i));
+    ASSERT_EQ(qt_->size(), boxes.size());
+
+    for (int i = 0; i < 1000; i++) {
+        int x = rng.rng(width_);
+        int y = rng.rng(height_);
+
+        auto expected = brute_force_get(boxes, x, y);
+        auto res = qt_->get(x, y);
+        std::sort(res.begin(), res.end());
+        ASSERT_EQ(res, expected) << "query at " << x << ", " << y;
+    }
+}
+
+// Test that point queries agree with BoundingBox::contains on box edges and
+// return nothing for points outside of the tree's bounds.
+TEST_F(QuadTreeTest, get_edges_and_out_of_bounds)
+{
+    ASSERT_TRUE(qt_->get(50, 50).empty());
+
+    QT::BoundingBox box(10, 20, 30, 40);
+    ASSERT_TRUE(qt_->insert(box, 1));
+
+    for (int x = 0; x <= width_; x++) {
+        for (int y = 0; y <= height_; y++) {
+            auto res = qt_->get(x, y);
+            if (box.contains(x, y)) {
+                ASSERT_EQ(res.size(), 1UL) << "query at " << x << ", " << y;
+                ASSERT_EQ(res.at(0), 1);
+            } else {
+                ASSERT_TRUE(res.empty()) << "query at " << x << ", " << y;
+            }
+        }
+    }
+
+    ASSERT_TRUE(qt_->get(-1, 25).empty());
+    ASSERT_TRUE(qt_->get(15, -1).empty());
+    ASSERT_TRUE(qt_->get(width_ + 1, 25).empty());
+    ASSERT_TRUE(qt_->get(15, height_ + 1).empty());
+}
+
+// Test that the tree stays consistent while it is being filled: inserts and
+// point queries are interleaved and every query is checked against a
+// brute-force reference of everything inserted so far.
+TEST_F(QuadTreeTest, interleaved_insert_get)
+{
+    auto rng = NEXTPNR_NAMESPACE::DeterministicRNG();
+
+    std::vector<QT::BoundingBox> boxes;
+    rng.rngseed(2);
+    for (int i = 0; i < 20000; i++) {
+        if (rng.rng(10) != 0) {
+            int x0 = rng.rng(width_);
+            int y0 = rng.rng(height_);
+            int w = rng.rng(width_ - x0);
+            int h = rng.rng(height_ - y0);
+            boxes.push_back(QT::BoundingBox(x0, y0, x0 + w / 8, y0 + h / 8));
+            ASSERT_TRUE(qt_->insert(boxes.back(), int(boxes.size()) - 1));
+            ASSERT_EQ(qt_->size(), boxes.size());
+            continue;
+        }
+
+        int x = rng.rng(width_);
+        int y = rng.rng(height_);
+
+        auto expected = brute_force_get(boxes, x, y);
+        auto res = qt_->get(x, y);
+        std::sort(res.begin(), res.end());
+        ASSERT_EQ(res, expected) << "query at " << x << ", " << y << " after " << boxes.size() << " inserts";
+    }
+}
+
+// Test that the tree also works with floating point coordinates, as used by
+// the GUI for decal bounding boxes.
+TEST(QuadTreeFloatTest, insert_get_matches_brute_force)
+{
+    using FQT = QuadTree<float, int>;
+    FQT qt(FQT::BoundingBox(0, 0, 100, 100));
+    auto rng = NEXTPNR_NAMESPACE::DeterministicRNG();
+
+    std::vector<FQT::BoundingBox> boxes;
+    rng.rngseed(3);
+    for (int i = 0; i < 10000; i++) {
+        float x0 = rng.rng(10000) / 100.0f;
+        float y0 = rng.rng(10000) / 100.0f;
+        float w = rng.rng(1000) / 100.0f;
+        float h = rng.rng(1000) / 100.0f;
+        boxes.push_back(FQT::BoundingBox(x0, y0, std::min(x0 + w, 100.0f), std::min(y0 + h, 100.0f)));
+        ASSERT_TRUE(qt.insert(boxes.back(), i));
+    }
+    ASSERT_EQ(qt.size(), boxes.size());
+
+    for (int i = 0; i < 1000; i++) {
+        float x = rng.rng(10000) / 100.0f;
+        float y = rng.rng(10000) / 100.0f;
+
+        auto expected = brute_force_get(boxes, x, y);
+        auto res = qt.get(x, y);
+        std::sort(res.begin(), res.end());
+        ASSERT_EQ(res, expected) << "query at " << x << ", " << y;
+    }
+}
@@ -0,0 +1,316 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2018  Clifford Wolf <clifford@symbioticeda.com>
+ *  Copyright (C) 2018  Miodrag Milanovic <miodrag@symbioticeda.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef ICE40_ARCH_CHECKS_H
+#define ICE40_ARCH_CHECKS_H
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Architecture database invariants shared by the per-device tests. The name
+// checks intern strings and therefore run on the calling thread; the pip
+// graph checks only read the chipdb and are split over worker threads.
+
+// Fixture of the per-device tests, Device::args() gives the ArchArgs of the
+// device. The tests only read from the architecture, so one Context is shared
+// by all tests of a device instead of being rebuilt for each of them.
+template <typename Device> class DeviceTest : public ::testing::Test
+{
+  protected:
+    static void SetUpTestCase() { ctx = new Context(Device::args()); }
+
+    static void TearDownTestCase()
+    {
+        delete ctx;
+        ctx = nullptr;
+    }
+
+    static Context *ctx;
+};
+
+template <typename Device> Context *DeviceTest<Device>::ctx = nullptr;
+
+inline void check_bel_names(Context *ctx, int expected_count)
+{
+    int bel_count = 0;
+    for (auto bel : ctx->getBels()) {
+        auto name = ctx->getBelName(bel);
+        ASSERT_EQ(bel, ctx->getBelByName(name));
+        bel_count++;
+    }
+    ASSERT_EQ(bel_count, expected_count);
+}
+
+inline void check_wire_names(Context *ctx, int expected_count)
+{
+    int wire_count = 0;
+    for (auto wire : ctx->getWires()) {
+        auto name = ctx->getWireName(wire);
+        ASSERT_EQ(wire, ctx->getWireByName(name));
+        wire_count++;
+    }
+    ASSERT_EQ(wire_count, expected_count);
+}
+
+inline void check_pip_names(Context *ctx, int expected_count)
+{
+    int pip_count = 0;
+    for (auto pip : ctx->getPips()) {
+        auto name = ctx->getPipName(pip);
+        ASSERT_EQ(pip, ctx->getPipByName(name));
+        pip_count++;
+    }
+    ASSERT_EQ(pip_count, expected_count);
+}
+
+inline void check_unknown_names(Context *ctx)
+{
+    ASSERT_EQ(BelId(), ctx->getBelByName(ctx->id("X0/Y0/no_such_bel")));
+    ASSERT_EQ(WireId(), ctx->getWireByName(ctx->id("X0/Y0/no_such_wire")));
+    ASSERT_EQ(PipId(), ctx->getPipByName(ctx->id("X0/Y0/no_such_pip")));
+
+    // Names that differ from a real one only by a suffix must not alias it.
+    auto bel_name = ctx->getBelName(*ctx->getBels().begin()).str(ctx);
+    ASSERT_EQ(BelId(), ctx->getBelByName(ctx->id(bel_name + "_")));
+    auto wire_name = ctx->getWireName(*ctx->getWires().begin()).str(ctx);
+    ASSERT_EQ(WireId(), ctx->getWireByName(ctx->id(wire_name + "_")));
+    auto pip_name = ctx->getPipName(*ctx->getPips().begin()).str(ctx);
+    ASSERT_EQ(PipId(), ctx->getPipByName(ctx->id(pip_name + "_")));
+}
+
+// Every pin of every bel must be listed among the bel pins of its wire.
+inline void check_bel_pins(Context *ctx)
+{
+    for (auto bel : ctx->getBels()) {
+        for (auto pin : ctx->getBelPins(bel)) {
+            WireId wire = ctx->getBelPinWire(bel, pin);
+            if (wire == WireId())
+                continue;
+            bool found = false;
+            for (auto bel_pin : ctx->getWireBelPins(wire)) {
+                if (bel_pin.bel == bel && bel_pin.pin == pin) {
+                    found = true;
+                    break;
+                }
+            }
+            ASSERT_TRUE(found) << "bel " << ctx->getBelName(bel).str(ctx) << " pin " << pin.str(ctx)
+                               << " missing from wire " << ctx->getWireName(wire).str(ctx);
+        }
+    }
+}
+
+inline size_t shard_count() { return std::max(1U, std::thread::hardware_concurrency()); }
+
+// Runs func(begin, end, shard) over contiguous index shards of [0, count) on
+// one thread per shard.
+template <typename Func> void for_each_shard(size_t count, Func func)
+{
+    size_t shards = shard_count();
+    size_t shard_size = (count + shards - 1) / shards;
+    std::vector<std::thread> threads;
+    for (size_t shard = 0; shard < shards; shard++) {
+        size_t begin = std::min(count, shard * shard_size);
+        size_t end = std::min(count, begin + shard_size);
+        threads.emplace_back(func, begin, end, shard);
+    }
+    for (auto &thread : threads)
+        thread.join();
+}
+
+inline std::vector<WireId> all_wires(Context *ctx)
+{
+    std::vector<WireId> wires;
+    for (auto wire : ctx->getWires())
+        wires.push_back(wire);
+    return wires;
+}
+
+inline int pip_index_count(Context *ctx)
+{
+    int pip_count = 0;
+    for (auto pip : ctx->getPips())
+        pip_count = std::max(pip_count, pip.index + 1);
+    return pip_count;
+}
+
+// Counts the pips a shard found inconsistent and remembers the first one,
+// together with the wire it was listed under, so a failure can be reported
+// by name once the shards have joined.
+struct PipErrors
+{
+    int count = 0;
+    WireId wire;
+    PipId pip;
+
+    void add(WireId w, PipId p)
+    {
+        if (count++ == 0) {
+            wire = w;
+            pip = p;
+        }
+    }
+};
+
+inline int error_count(const std::vector<PipErrors> &errors)
+{
+    int count = 0;
+    for (auto &shard_errors : errors)
+        count += shard_errors.count;
+    return count;
+}
+
+inline std::string describe_errors(Context *ctx, const std::vector<PipErrors> &errors)
+{
+    int pip_count = pip_index_count(ctx);
+    std::string msg;
+    for (size_t shard = 0; shard < errors.size(); shard++) {
+        const PipErrors &shard_errors = errors[shard];
+        if (shard_errors.count == 0)
+            continue;
+        msg += "\nshard " + std::to_string(shard) + ": " + std::to_string(shard_errors.count) + " error(s), first pip ";
+        if (shard_errors.pip.index >= 0 && shard_errors.pip.index < pip_count)
+            msg += ctx->getPipName(shard_errors.pip).str(ctx);
+        else
+            msg += "index " + std::to_string(shard_errors.pip.index) + " (out of range)";
+        msg += " on wire " + ctx->getWireName(shard_errors.wire).str(ctx);
+    }
+    return msg;
+}
+
+// Worker threads must not throw, so pip indices are checked against the
+// per-pip counters before use and an out-of-range index is an error.
+inline bool pip_in_range(PipId pip, const std::vector<int> &counts)
+{
+    return pip.index >= 0 && size_t(pip.index) < counts.size();
+}
+
+// The downhill pips of all wires must add up to the device pip count, and
+// each must have the wire it is listed under as its source.
+inline void check_pips_downhill(Context *ctx, int expected_count)
+{
+    auto wires = all_wires(ctx);
+    std::vector<int> pip_count(shard_count());
+    std::vector<PipErrors> errors(shard_count());
+    for_each_shard(wires.size(), [&](size_t begin, size_t end, size_t shard) {
+        for (size_t i = begin; i < end; i++) {
+            for (auto pip : ctx->getPipsDownhill(wires[i])) {
+                if (ctx->getPipSrcWire(pip) != wires[i])
+                    errors[shard].add(wires[i], pip);
+                pip_count[shard]++;
+            }
+        }
+    });
+    ASSERT_EQ(error_count(errors), 0) << describe_errors(ctx, errors);
+    ASSERT_EQ(std::accumulate(pip_count.begin(), pip_count.end(), 0), expected_count);
+}
+
+// The uphill pips of all wires must add up to the device pip count, and each
+// must have the wire it is listed under as its destination.
+inline void check_pips_uphill(Context *ctx, int expected_count)
+{
+    auto wires = all_wires(ctx);
+    std::vector<int> pip_count(shard_count());
+    std::vector<PipErrors> errors(shard_count());
+    for_each_shard(wires.size(), [&](size_t begin, size_t end, size_t shard) {
+        for (size_t i = begin; i < end; i++) {
+            for (auto pip : ctx->getPipsUphill(wires[i])) {
+                if (ctx->getPipDstWire(pip) != wires[i])
+                    errors[shard].add(wires[i], pip);
+                pip_count[shard]++;
+            }
+        }
+    });
+    ASSERT_EQ(error_count(errors), 0) << describe_errors(ctx, errors);
+    ASSERT_EQ(std::accumulate(pip_count.begin(), pip_count.end(), 0), expected_count);
+}
+
+// Each uphill pip must appear exactly once in the downhill list of its
+// source wire. The downhill lists are counted once up front so the check is
+// linear in the number of pips. A pip is only counted under its own source
+// wire, which lives in exactly one shard, so the shards never write to the
+// same counter.
+inline void check_uphill_to_downhill(Context *ctx)
+{
+    auto wires = all_wires(ctx);
+    std::vector<int> downhill_count(pip_index_count(ctx));
+    std::vector<PipErrors> errors(shard_count());
+    for_each_shard(wires.size(), [&](size_t begin, size_t end, size_t shard) {
+        for (size_t i = begin; i < end; i++) {
+            for (auto downhill_pip : ctx->getPipsDownhill(wires[i])) {
+                if (!pip_in_range(downhill_pip, downhill_count))
+                    errors[shard].add(wires[i], downhill_pip);
+                else if (ctx->getPipSrcWire(downhill_pip) == wires[i])
+                    downhill_count[downhill_pip.index]++;
+            }
+        }
+    });
+    ASSERT_EQ(error_count(errors), 0) << describe_errors(ctx, errors);
+
+    for_each_shard(wires.size(), [&](size_t begin, size_t end, size_t shard) {
+        for (size_t i = begin; i < end; i++) {
+            for (auto uphill_pip : ctx->getPipsUphill(wires[i])) {
+                if (!pip_in_range(uphill_pip, downhill_count) || downhill_count[uphill_pip.index] != 1)
+                    errors[shard].add(wires[i], uphill_pip);
+            }
+        }
+    });
+    ASSERT_EQ(error_count(errors), 0) << describe_errors(ctx, errors);
+}
+
+// Each downhill pip must appear exactly once in the uphill list of its
+// destination wire.
+inline void check_downhill_to_uphill(Context *ctx)
+{
+    auto wires = all_wires(ctx);
+    std::vector<int> uphill_count(pip_index_count(ctx));
+    std::vector<PipErrors> errors(shard_count());
+    for_each_shard(wires.size(), [&](size_t begin, size_t end, size_t shard) {
+        for (size_t i = begin; i < end; i++) {
+            for (auto uphill_pip : ctx->getPipsUphill(wires[i])) {
+                if (!pip_in_range(uphill_pip, uphill_count))
+                    errors[shard].add(wires[i], uphill_pip);
+                else if (ctx->getPipDstWire(uphill_pip) == wires[i])
+                    uphill_count[uphill_pip.index]++;
+            }
+        }
+    });
+    ASSERT_EQ(error_count(errors), 0) << describe_errors(ctx, errors);
+
+    for_each_shard(wires.size(), [&](size_t begin, size_t end, size_t shard) {
+        for (size_t i = begin; i < end; i++) {
+            for (auto downhill_pip : ctx->getPipsDownhill(wires[i])) {
+                if (!pip_in_range(downhill_pip, uphill_count) || uphill_count[downhill_pip.index] != 1)
+                    errors[shard].add(wires[i], downhill_pip);
+            }
+        }
+    });
+    ASSERT_EQ(error_count(errors), 0) << describe_errors(ctx, errors);
+}
+
+NEXTPNR_NAMESPACE_END
+
+#endif
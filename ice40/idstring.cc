@@ -0,0 +1,94 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2018  Clifford Wolf <clifford@symbioticeda.com>
+ *  Copyright (C) 2018  Miodrag Milanovic <miodrag@symbioticeda.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <QDir>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "gtest/gtest.h"
+#include "ice40commandhandler.h"
+#include "nextpnr.h"
+
+USING_NEXTPNR_NAMESPACE
+
+namespace {
+
+const QDir dir("tests/ice40/load_test_files");
+
+// Collects cell, cell type, port and net names of a real netlist.
+std::vector<std::string> netlist_names(const QString &file)
+{
+    char init[] = "nextpnr_ice40";
+    char arch[] = "--hx1k";
+    char pack1[] = "--package";
+    char pack2[] = "tq144";
+    char *args[] = {init, arch, pack1, pack2};
+
+    Ice40CommandHandler handler(4, args);
+    std::unique_ptr<Context> ctx = handler.load_json(dir.absoluteFilePath(file).toStdString());
+
+    std::vector<std::string> names;
+    for (auto &cell : ctx->cells) {
+        names.push_back(cell.first.str(ctx.get()));
+        names.push_back(cell.second->type.str(ctx.get()));
+        for (auto &port : cell.second->ports)
+            names.push_back(port.first.str(ctx.get()));
+    }
+    for (auto &net : ctx->nets)
+        names.push_back(net.first.str(ctx.get()));
+    return names;
+}
+
+} // namespace
+
+// Interning the same string must always return the same IdString, different
+// strings must never share one, and constids must be preserved.
+TEST(IdStringTest, intern_netlist_names)
+{
+    std::vector<std::string> names;
+    for (QString file : {"blinky.json", "fsm_simple.json", "uart_transmission.json", "buttons_debounce.json"}) {
+        auto file_names = netlist_names(file);
+        names.insert(names.end(), file_names.begin(), file_names.end());
+    }
+    ASSERT_FALSE(names.empty());
+
+    ArchArgs chipArgs;
+    chipArgs.type = ArchArgs::HX1K;
+    chipArgs.package = "tq144";
+    Context ctx(chipArgs);
+
+    std::vector<IdString> ids;
+    for (auto &name : names)
+        ids.push_back(ctx.id(name));
+
+    // Look everything up again in reverse order, now that all names exist.
+    std::unordered_map<int, std::string> name_by_index;
+    for (size_t i = names.size(); i-- > 0;) {
+        ASSERT_EQ(ctx.id(names[i]), ids[i]) << names[i];
+        ASSERT_EQ(ids[i].str(&ctx), names[i]);
+        auto inserted = name_by_index.emplace(ids[i].index, names[i]);
+        ASSERT_EQ(inserted.first->second, names[i]) << "index " << ids[i].index << " shared";
+    }
+
+    ASSERT_EQ(ctx.id("ICESTORM_LC"), id_ICESTORM_LC);
+    ASSERT_EQ(ctx.id("SB_IO"), id_SB_IO);
+    ASSERT_EQ(ctx.id(""), IdString());
+}
@@ -10,16 +10,23 @@
 #include <vector>
 #include "ice40commandhandler.h"
 #include <string>
+#include <map>
+#include <algorithm>
 
 USING_NEXTPNR_NAMESPACE
 
 const QDir dir("tests/ice40/load_test_files");
 void compare_ctx_objects(QString file, char **args, int argv);
+void place_and_route(Context *ctx);
+void check_routing_state(Context *ctx, const QString &file);
+void check_netlist_refs(Context *ctx, const QString &file);
+uint64_t structural_hash(Context *ctx);
+std::vector<std::string> read_asc_lines(std::istream &in);
 
 
 TEST(LOAD_Test, parser){
 
-    std::vector<QString> failure_files = {"no_device.asc", "multiply_devices.asc", "unknown_device_device.asc", "device_after_tile.asc",
+    std::vector<QString> failure_files = {"no_device.asc", "multiply_devices.asc", "unknown_device.asc", "device_after_tile.asc",
                                           "missing_coord.asc", "neg_coord.asc", "too_large_coord.asc", "wrong_symbol_tile_bit_row.asc",
                                           "too_short_tile_bit_row.asc", "too_large_tile_bit_row.asc", "extra_tile_bit_row.asc",
                                           "missing_tile_bit_row.asc", "missing_wire_id.asc", "missing_net_name.asc"};
@@ -76,6 +83,207 @@ TEST(LOAD_Test, load_write_test){
 
 }
 
+TEST(LOAD_Test, deterministic_reload){
+
+    //Reconstruction must not depend on hash map or thread scheduling order:
+    //loading the same file twice has to give identical nets and cells
+    std::unique_ptr<Context> ctx_a, ctx_b;
+    {
+        std::ifstream in(dir.absoluteFilePath("blinky.asc").toStdString());
+        ASSERT_NO_THROW(ctx_a = read_asc(in));
+    }
+    {
+        std::ifstream in(dir.absoluteFilePath("blinky.asc").toStdString());
+        ASSERT_NO_THROW(ctx_b = read_asc(in));
+    }
+
+    ASSERT_EQ(ctx_a->nets.size(), ctx_b->nets.size());
+    for(auto &net_a : ctx_a->nets){
+        std::string name = net_a.first.str(ctx_a.get());
+        auto net_b = ctx_b->nets.find(ctx_b->id(name));
+        ASSERT_NE(net_b, ctx_b->nets.end()) << "net " << name << " only in first load";
+        ASSERT_EQ(net_a.second->wires.size(), net_b->second->wires.size()) << "net " << name;
+        for(auto &wire_a : net_a.second->wires){
+            auto wire_b = net_b->second->wires.find(wire_a.first);
+            ASSERT_NE(wire_b, net_b->second->wires.end()) << "net " << name;
+            ASSERT_EQ(wire_a.second.pip, wire_b->second.pip) << "net " << name;
+        }
+        ASSERT_EQ(net_a.second->driver.cell == nullptr, net_b->second->driver.cell == nullptr) << "net " << name;
+        if(net_a.second->driver.cell){
+            ASSERT_EQ(net_a.second->driver.cell->name.str(ctx_a.get()), net_b->second->driver.cell->name.str(ctx_b.get()))
+                    << "net " << name;
+            ASSERT_EQ(net_a.second->driver.port.str(ctx_a.get()), net_b->second->driver.port.str(ctx_b.get()))
+                    << "net " << name;
+        }
+        ASSERT_EQ(net_a.second->users.size(), net_b->second->users.size()) << "net " << name;
+    }
+
+    ASSERT_EQ(ctx_a->cells.size(), ctx_b->cells.size());
+    for(auto &cell_a : ctx_a->cells){
+        std::string name = cell_a.first.str(ctx_a.get());
+        auto cell_b = ctx_b->cells.find(ctx_b->id(name));
+        ASSERT_NE(cell_b, ctx_b->cells.end()) << "cell " << name << " only in first load";
+        ASSERT_EQ(cell_a.second->type.str(ctx_a.get()), cell_b->second->type.str(ctx_b.get())) << "cell " << name;
+        ASSERT_EQ(cell_a.second->bel, cell_b->second->bel) << "cell " << name;
+    }
+}
+
+TEST(LOAD_Test, write_matches_reference){
+
+    //Writing back a loaded asc file must reproduce it line for line and in the same order,
+    //whatever order the tiles are generated in. ".sym" lines are skipped since net names are not restorable.
+    std::unique_ptr<Context> ctx;
+    std::ifstream in(dir.absoluteFilePath("blinky.asc").toStdString());
+    ASSERT_TRUE(in.is_open()) << "file: blinky.asc\n" << "could not be opened";
+    ASSERT_NO_THROW(ctx = read_asc(in));
+
+    std::stringstream out;
+    ASSERT_NO_THROW(write_asc(ctx.get(), out));
+
+    std::ifstream ref(dir.absoluteFilePath("blinky.asc").toStdString());
+    ASSERT_TRUE(ref.is_open()) << "file: blinky.asc\n" << "could not be opened";
+    std::vector<std::string> ref_lines = read_asc_lines(ref);
+    std::vector<std::string> out_lines = read_asc_lines(out);
+    ASSERT_FALSE(out_lines.empty());
+    for(size_t i = 0; i < std::min(ref_lines.size(), out_lines.size()); i++){
+        ASSERT_EQ(ref_lines[i], out_lines[i]) << "file: blinky.asc\n" << "line " << i + 1 << " (ignoring .sym lines)";
+    }
+    ASSERT_EQ(ref_lines.size(), out_lines.size()) << "file: blinky.asc\n" << "line count differs";
+}
+
+TEST(LOAD_Test, deterministic_flow){
+
+    //Two runs of the same design with the same seed must produce the same placement and routing
+    std::vector<uint64_t> hashes;
+    for(int run = 0; run < 2; run++){
+        char init[] = "nextpnr_ice40";
+        char arch[] = "--hx1k";
+        char pack1[] = "--package";
+        char pack2[] = "tq144";
+        char *args[4];
+        args[0] = init;
+        args[1] = arch;
+        args[2] = pack1;
+        args[3] = pack2;
+
+        Ice40CommandHandler handler(4, args);
+        std::unique_ptr<Context> ctx;
+        ASSERT_NO_THROW(ctx = handler.load_json(dir.absoluteFilePath("blinky.json").toStdString()));
+        place_and_route(ctx.get());
+        hashes.push_back(structural_hash(ctx.get()));
+    }
+    ASSERT_EQ(hashes.at(0), hashes.at(1));
+}
+
+//Reads the non-empty lines of an asc file, skipping ".sym" lines since net names are not restorable.
+std::vector<std::string> read_asc_lines(std::istream &in){
+    std::vector<std::string> lines;
+    std::string str_line;
+    while(std::getline(in, str_line)){
+        if(!str_line.empty() && str_line.substr(0,4) != ".sym")
+            lines.push_back(str_line);
+    }
+    return lines;
+}
+
+//Splits an asc file into its sections (".device", ".logic_tile x y", ".ram_data x y", ...)
+//keyed by the section header line. ".sym" lines are skipped since net names are not restorable.
+static void read_asc_sections(std::istream &in, std::map<std::string, std::vector<std::string>> &sections,
+                              const QString &file){
+    std::string key;
+    std::string str_line;
+    while(std::getline(in, str_line)){
+        if(str_line.empty() || str_line.substr(0,4) == ".sym"){
+            continue;
+        }else if(str_line[0] == '.'){
+            key = str_line;
+            ASSERT_TRUE(sections.find(key) == sections.end())
+                    << "file: " << file.toStdString() << "\n" << "duplicate section \"" << key << "\"";
+            sections[key];
+        }else if(!key.empty()){
+            sections[key].push_back(str_line);
+        }
+    }
+}
+
+//Compares two asc files section by section. Identical sections are skipped with a single
+//comparison, differing ones are reported down to the (section, row, bit) level.
+static void compare_asc(std::istream &ref, std::istream &load, const QString &file){
+    const int max_reported_bits = 16;
+
+    std::map<std::string, std::vector<std::string>> ref_sections, load_sections;
+    ASSERT_NO_FATAL_FAILURE(read_asc_sections(ref, ref_sections, file));
+    ASSERT_NO_FATAL_FAILURE(read_asc_sections(load, load_sections, file));
+
+    for(auto &section : load_sections){
+        ASSERT_TRUE(ref_sections.count(section.first)) << "file: " << file.toStdString() << "\n"
+                                                       << "could not find \"" << section.first << "\" in reference file";
+    }
+
+    for(auto &section_ref : ref_sections){
+        auto section_load = load_sections.find(section_ref.first);
+        ASSERT_TRUE(section_load != load_sections.end()) << "file: " << file.toStdString() << "\n"
+                                                         << "could not find \"" << section_ref.first << "\" in loaded file";
+        if(section_ref.second == section_load->second)
+            continue;
+
+        const std::vector<std::string> &rows_ref = section_ref.second;
+        const std::vector<std::string> &rows_load = section_load->second;
+        EXPECT_EQ(rows_ref.size(), rows_load.size()) << "file: " << file.toStdString() << "\n"
+                                                      << "row count differs in \"" << section_ref.first << "\"";
+        int differing_bits = 0;
+        for(size_t row = 0; row < std::min(rows_ref.size(), rows_load.size()); row++){
+            if(rows_ref[row] == rows_load[row])
+                continue;
+            if(rows_ref[row].size() != rows_load[row].size()){
+                ADD_FAILURE() << "file: " << file.toStdString() << "\n"
+                              << "row length differs in \"" << section_ref.first << "\" row " << row;
+                continue;
+            }
+            for(size_t bit = 0; bit < rows_ref[row].size(); bit++){
+                if(rows_ref[row][bit] == rows_load[row][bit])
+                    continue;
+                if(differing_bits++ < max_reported_bits){
+                    ADD_FAILURE() << "file: " << file.toStdString() << "\n"
+                                  << "\"" << section_ref.first << "\" row " << row << " bit " << bit
+                                  << ": reference " << rows_ref[row][bit] << ", loaded " << rows_load[row][bit];
+                }
+            }
+        }
+        if(differing_bits > max_reported_bits){
+            ADD_FAILURE() << "file: " << file.toStdString() << "\n"
+                          << differing_bits << " bits differ in \"" << section_ref.first << "\"";
+        }
+    }
+}
+
+//A parameter name interned in both the reference and the loaded context
+struct ParamId{
+    std::string name;
+    IdString ref;
+    IdString load;
+};
+
+static ParamId intern_param(Context *ref, Context *load, const std::string &name){
+    return ParamId{name, ref->id(name), load->id(name)};
+}
+
+static std::vector<ParamId> intern_params(Context *ref, Context *load, const std::vector<std::string> &names){
+    std::vector<ParamId> ids;
+    for(auto &name : names)
+        ids.push_back(intern_param(ref, load, name));
+    return ids;
+}
+
+//Interns the names of one of the bitstream parameter tables (rgb_params_get() etc.)
+template<typename Table>
+static std::vector<ParamId> intern_param_table(Context *ref, Context *load, const Table &table){
+    std::vector<ParamId> ids;
+    for(auto &param : table)
+        ids.push_back(intern_param(ref, load, param.first));
+    return ids;
+}
+
 void compare_ctx_objects(QString file, char **args, int argv){
 
     Ice40CommandHandler handler(argv, args);
@@ -83,18 +291,16 @@ void compare_ctx_objects(QString file, char **args, int argv){
     ASSERT_NO_THROW(ctx_norm = handler.load_json(dir.absoluteFilePath(file).toStdString());)
             << "file: " << file.toStdString() << "\n";
 
-    ctx_norm->pack();
-    assign_budget(ctx_norm.get());
-    ctx_norm->check();
-    ctx_norm->place();
-    ctx_norm->check();
-    ctx_norm->route();
+    place_and_route(ctx_norm.get());
+    ASSERT_NO_FATAL_FAILURE(check_routing_state(ctx_norm.get(), file));
+    ASSERT_NO_FATAL_FAILURE(check_netlist_refs(ctx_norm.get(), file));
 
     std::stringstream norm_write_out;
 
     ASSERT_NO_THROW(write_asc(ctx_norm.get(), norm_write_out)) << "file: " << file.toStdString() << "\n";
     std::unique_ptr<Context> ctx_load;
     ASSERT_NO_THROW(ctx_load = read_asc(norm_write_out)) << "file: " << file.toStdString() << "\n";
+    ASSERT_NO_FATAL_FAILURE(check_netlist_refs(ctx_load.get(), file));
 
 
     if(ctx_norm->archArgs().type == ArchArgs::HX1K || ctx_norm->archArgs().type == ArchArgs::LP1K){
@@ -237,6 +443,26 @@ void compare_ctx_objects(QString file, char **args, int argv){
     ASSERT_EQ(ctx_norm->cells.size() - not_reconstructable_cells , ctx_load->cells.size())
             << "file: " << file.toStdString() << "\n";
 
+    //Parameter names are interned once up front instead of once per cell and parameter
+    const ParamId lut_init = intern_param(ctx_norm.get(), ctx_load.get(), "LUT_INIT");
+    const std::vector<ParamId> lc_params = intern_params(ctx_norm.get(), ctx_load.get(),
+            {"NEG_CLK", "DFF_ENABLE", "ASYNC_SR", "SET_NORESET", "CARRY_ENABLE", "CIN_SET"});
+    const std::vector<ParamId> io_params = intern_params(ctx_norm.get(), ctx_load.get(),
+            {"PIN_TYPE", "NEG_TRIGGER", "PULLUP"});
+    const ParamId pullup_resistor = intern_param(ctx_norm.get(), ctx_load.get(), "PULLUP_RESISTOR");
+    const std::vector<ParamId> ram_params = intern_params(ctx_norm.get(), ctx_load.get(),
+            {"NEG_CLK_R", "NEG_CLK_W", "WRITE_MODE", "READ_MODE"});
+    const std::vector<ParamId> ram_init_params = intern_params(ctx_norm.get(), ctx_load.get(),
+            {"INIT_0", "INIT_1", "INIT_2", "INIT_3", "INIT_4", "INIT_5", "INIT_6", "INIT_7",
+             "INIT_8", "INIT_9", "INIT_A", "INIT_B", "INIT_C", "INIT_D", "INIT_E", "INIT_F"});
+    const std::vector<ParamId> rgb_params = intern_param_table(ctx_norm.get(), ctx_load.get(), rgb_params_get());
+    const std::vector<ParamId> rgba_params = intern_param_table(ctx_norm.get(), ctx_load.get(), rgba_params_get());
+    const std::vector<ParamId> mac16_params = intern_param_table(ctx_norm.get(), ctx_load.get(), mac16_params_get());
+    const std::vector<ParamId> hfosc_params = ctx_norm->args.type != ArchArgs::U4K
+            ? intern_param_table(ctx_norm.get(), ctx_load.get(), hfosc_params_u4k_get())
+            : intern_param_table(ctx_norm.get(), ctx_load.get(), hfosc_params_get());
+    const std::vector<ParamId> pll_params = intern_param_table(ctx_norm.get(), ctx_load.get(), pll_params_get());
+
     for(auto &cell_ref : ctx_norm->cells){
         ASSERT_NE(cell_ref.second->bel, BelId()) << "file: " << file.toStdString() << "\n"
                                                  << "found unplaced cell in reference context";
@@ -255,62 +481,39 @@ void compare_ctx_objects(QString file, char **args, int argv){
 
         if(cell_ref.second->type == id_ICESTORM_LC){
             const ChipInfoPOD &ci = *ctx_norm->chip_info;
-            int lut_init_ref = permute(ctx_norm.get(), get_param_or_def(ctx_norm.get(), cell_ref.second.get(), ctx_norm->id("LUT_INIT")),
+            int lut_init_ref = permute(ctx_norm.get(), get_param_or_def(ctx_norm.get(), cell_ref.second.get(), lut_init.ref),
                                             bel, ci);
             EXPECT_EQ(lut_init_ref,
-                      get_param_or_def(ctx_load.get(), cell_load, ctx_load->id("LUT_INIT")))
-                    << "file: " << file.toStdString() << "\n"
-                    << id_ICESTORM_LC.str(ctx_norm.get()) << " " << cell_ref.first.str(ctx_norm.get());
-            EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), ctx_norm->id("NEG_CLK")),
-                      get_param_or_def(ctx_load.get(), cell_load, ctx_load->id("NEG_CLK")))
-                    << "file: " << file.toStdString() << "\n"
-                    << id_ICESTORM_LC.str(ctx_norm.get()) << " " << cell_ref.first.str(ctx_norm.get());
-            EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), ctx_norm->id("DFF_ENABLE")),
-                      get_param_or_def(ctx_load.get(), cell_load, ctx_load->id("DFF_ENABLE")))
-                    << "file: " << file.toStdString() << "\n"
-                    << id_ICESTORM_LC.str(ctx_norm.get()) << " " << cell_ref.first.str(ctx_norm.get());
-            EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), ctx_norm->id("ASYNC_SR")),
-                      get_param_or_def(ctx_load.get(), cell_load, ctx_load->id("ASYNC_SR")))
-                    << "file: " << file.toStdString() << "\n"
-                    << id_ICESTORM_LC.str(ctx_norm.get()) << " " << cell_ref.first.str(ctx_norm.get());
-            EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), ctx_norm->id("SET_NORESET")),
-                      get_param_or_def(ctx_load.get(), cell_load, ctx_load->id("SET_NORESET")))
-                    << "file: " << file.toStdString() << "\n"
-                    << id_ICESTORM_LC.str(ctx_norm.get()) << " " << cell_ref.first.str(ctx_norm.get());
-            EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), ctx_norm->id("CARRY_ENABLE")),
-                      get_param_or_def(ctx_load.get(), cell_load, ctx_load->id("CARRY_ENABLE")))
-                    << "file: " << file.toStdString() << "\n"
-                    << id_ICESTORM_LC.str(ctx_norm.get()) << " " << cell_ref.first.str(ctx_norm.get());
-            EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), ctx_norm->id("CIN_SET")),
-                      get_param_or_def(ctx_load.get(), cell_load, ctx_load->id("CIN_SET")))
+                      get_param_or_def(ctx_load.get(), cell_load, lut_init.load))
                     << "file: " << file.toStdString() << "\n"
                     << id_ICESTORM_LC.str(ctx_norm.get()) << " " << cell_ref.first.str(ctx_norm.get());
+            for(auto &param : lc_params){
+                EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), param.ref),
+                          get_param_or_def(ctx_load.get(), cell_load, param.load))
+                        << "file: " << file.toStdString() << "\n"
+                        << id_ICESTORM_LC.str(ctx_norm.get()) << " " << cell_ref.first.str(ctx_norm.get())
+                        << "\nparameter: "  << param.name;
+            }
         }else if (cell_ref.second->type == id_SB_IO) {
-
-            EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), ctx_norm->id("PIN_TYPE")),
-                      get_param_or_def(ctx_load.get(), cell_load, ctx_load->id("PIN_TYPE")))
-                    << "file: " << file.toStdString() << "\n"
-                    << id_SB_IO.str(ctx_norm.get()) << " " << cell_ref.first.str(ctx_norm.get());
-            EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), ctx_norm->id("NEG_TRIGGER")),
-                      get_param_or_def(ctx_load.get(), cell_load, ctx_load->id("NEG_TRIGGER")))
-                    << "file: " << file.toStdString() << "\n"
-                    << id_SB_IO.str(ctx_norm.get()) << " " << cell_ref.first.str(ctx_norm.get());
-            EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), ctx_norm->id("PULLUP")),
-                      get_param_or_def(ctx_load.get(), cell_load, ctx_load->id("PULLUP")))
-                    << "file: " << file.toStdString() << "\n"
-                    << id_SB_IO.str(ctx_norm.get()) << " " << cell_ref.first.str(ctx_norm.get());
+            for(auto &param : io_params){
+                EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), param.ref),
+                          get_param_or_def(ctx_load.get(), cell_load, param.load))
+                        << "file: " << file.toStdString() << "\n"
+                        << id_SB_IO.str(ctx_norm.get()) << " " << cell_ref.first.str(ctx_norm.get())
+                        << "\nparameter: "  << param.name;
+            }
 
             EXPECT_EQ(cell_ref.second->ioInfo.lvds, cell_load->ioInfo.lvds)
                     << "file: " << file.toStdString() << "\n" ;
 
             if(!cell_ref.second->ioInfo.lvds && ctx_norm->archArgs().type == ArchArgs::UP5K){
                 std::string pullup_resistor_ref;
-                if (cell_ref.second->attrs.count(ctx_norm->id("PULLUP_RESISTOR")))
-                    pullup_resistor_ref = cell_ref.second->attrs.at(ctx_norm->id("PULLUP_RESISTOR")).as_string();
+                if (cell_ref.second->attrs.count(pullup_resistor.ref))
+                    pullup_resistor_ref = cell_ref.second->attrs.at(pullup_resistor.ref).as_string();
 
                 std::string pullup_resistor_load;
-                if (cell_load->attrs.count(ctx_load->id("PULLUP_RESISTOR")))
-                    pullup_resistor_load = cell_load->attrs.at(ctx_load->id("PULLUP_RESISTOR")).as_string();
+                if (cell_load->attrs.count(pullup_resistor.load))
+                    pullup_resistor_load = cell_load->attrs.at(pullup_resistor.load).as_string();
 
                 EXPECT_EQ(pullup_resistor_ref, pullup_resistor_load)
                         << "file: " << file.toStdString() << "\n" ;
@@ -318,25 +521,16 @@ void compare_ctx_objects(QString file, char **args, int argv){
         }else if(cell_ref.second->type == id_SB_GB){
 
         }else if(cell_ref.second->type == id_ICESTORM_RAM){
-            EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), ctx_norm->id("NEG_CLK_R")),
-                      get_param_or_def(ctx_load.get(), cell_load, ctx_load->id("NEG_CLK_R")))
-                    << "file: " << file.toStdString() << "\n"
-                    << id_ICESTORM_RAM.str(ctx_norm.get()) << " " << cell_ref.first.str(ctx_norm.get());
-            EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), ctx_norm->id("NEG_CLK_W")),
-                      get_param_or_def(ctx_load.get(), cell_load, ctx_load->id("NEG_CLK_W")))
-                    << "file: " << file.toStdString() << "\n"
-                    << id_ICESTORM_RAM.str(ctx_norm.get()) << " " << cell_ref.first.str(ctx_norm.get());
-            EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), ctx_norm->id("WRITE_MODE")),
-                      get_param_or_def(ctx_load.get(), cell_load, ctx_load->id("WRITE_MODE")))
-                    << "file: " << file.toStdString() << "\n"
-                    << id_ICESTORM_RAM.str(ctx_norm.get()) << " " << cell_ref.first.str(ctx_norm.get());
-            EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), ctx_norm->id("READ_MODE")),
-                      get_param_or_def(ctx_load.get(), cell_load, ctx_load->id("READ_MODE")))
-                    << "file: " << file.toStdString() << "\n"
-                    << id_ICESTORM_RAM.str(ctx_norm.get()) << " " << cell_ref.first.str(ctx_norm.get());
-            for(auto digit : "0123456789ABCDEF"){
-                std::string prop_ref = cell_ref.second->params[ctx_norm->id(std::string("INIT_") + digit)].to_string();
-                std::string prop_load = cell_load->params[ctx_load->id(std::string("INIT_") + digit)].to_string();
+            for(auto &param : ram_params){
+                EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), param.ref),
+                          get_param_or_def(ctx_load.get(), cell_load, param.load))
+                        << "file: " << file.toStdString() << "\n"
+                        << id_ICESTORM_RAM.str(ctx_norm.get()) << " " << cell_ref.first.str(ctx_norm.get())
+                        << "\nparameter: "  << param.name;
+            }
+            for(auto &param : ram_init_params){
+                std::string prop_ref = cell_ref.second->params[param.ref].to_string();
+                std::string prop_load = cell_load->params[param.load].to_string();
                 EXPECT_EQ(prop_ref.size(), prop_load.size())
                         << "file: " << file.toStdString() << "\n"
                         << id_ICESTORM_RAM.str(ctx_norm.get()) << " " << cell_ref.first.str(ctx_norm.get());
@@ -349,22 +543,22 @@ void compare_ctx_objects(QString file, char **args, int argv){
         }else if(cell_ref.second->type == id_SB_LED_DRV_CUR){
 
         }else if(cell_ref.second->type == id_SB_RGB_DRV){
-            for(auto param : rgb_params_get()){
-                EXPECT_EQ(get_param_str_or_def(cell_ref.second.get(), ctx_norm->id(param.first)),
-                          get_param_str_or_def(cell_load, ctx_load->id(param.first)))
+            for(auto &param : rgb_params){
+                EXPECT_EQ(get_param_str_or_def(cell_ref.second.get(), param.ref),
+                          get_param_str_or_def(cell_load, param.load))
                         << "file: " << file.toStdString() << "\n"
                         << "cell type: " << id_SB_RGB_DRV.str(ctx_norm.get())
                         << "\nreference cell: " << cell_ref.first.str(ctx_norm.get())
-                        << "\nparameter: "  << param.first;
+                        << "\nparameter: "  << param.name;
             }
         }else if(cell_ref.second->type == id_SB_RGBA_DRV){
-            for(auto param : rgba_params_get()){
-                EXPECT_EQ(get_param_str_or_def(cell_ref.second.get(), ctx_norm->id(param.first)),
-                          get_param_str_or_def(cell_load, ctx_load->id(param.first)))
+            for(auto &param : rgba_params){
+                EXPECT_EQ(get_param_str_or_def(cell_ref.second.get(), param.ref),
+                          get_param_str_or_def(cell_load, param.load))
                         << "file: " << file.toStdString() << "\n"
                         << "cell type: " << id_SB_RGBA_DRV.str(ctx_norm.get())
                         << "\nreference cell: " << cell_ref.first.str(ctx_norm.get())
-                        << "\nparameter: "  << param.first;
+                        << "\nparameter: "  << param.name;
             }
         }else if(cell_ref.second->type == id_SB_I2C){
             //TODO
@@ -373,42 +567,31 @@ void compare_ctx_objects(QString file, char **args, int argv){
         }else if(cell_ref.second->type == id_ICESTORM_SPRAM) {
 
         }else if(cell_ref.second->type == id_ICESTORM_DSP){
-            for(auto param : mac16_params_get()){
-                EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), ctx_norm->id(param.first)),
-                          get_param_or_def(ctx_load.get(), cell_load, ctx_load->id(param.first)))
+            for(auto &param : mac16_params){
+                EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), param.ref),
+                          get_param_or_def(ctx_load.get(), cell_load, param.load))
                         << "file: " << file.toStdString() << "\n"
                         << "cell type: " << id_ICESTORM_DSP.str(ctx_norm.get())
                         << "\nreference cell: " << cell_ref.first.str(ctx_norm.get())
-                        << "\nparameter: "  << param.first;
+                        << "\nparameter: "  << param.name;
             }
         }else if(cell_ref.second->type == id_ICESTORM_HFOSC){
-            if (ctx_norm->args.type != ArchArgs::U4K){
-                for(auto param : hfosc_params_u4k_get()){
-                    EXPECT_EQ(get_param_str_or_def(cell_ref.second.get(), ctx_norm->id(param.first)),
-                              get_param_str_or_def(cell_load, ctx_load->id(param.first)))
-                            << "file: " << file.toStdString() << "\n"
-                            << "cell type: " << id_ICESTORM_HFOSC.str(ctx_norm.get())
-                            << "\nreference cell: " << cell_ref.first.str(ctx_norm.get())
-                            << "\nparameter: "  << param.first;
-                }
-            }else{
-                for(auto param : hfosc_params_get()){
-                    EXPECT_EQ(get_param_str_or_def(cell_ref.second.get(), ctx_norm->id(param.first)),
-                              get_param_str_or_def(cell_load, ctx_load->id(param.first)))
-                            << "file: " << file.toStdString() << "\n"
-                            << "cell type: " << id_ICESTORM_HFOSC.str(ctx_norm.get())
-                            << "\nreference cell: " << cell_ref.first.str(ctx_norm.get())
-                            << "\nparameter: "  << param.first;
-                }
+            for(auto &param : hfosc_params){
+                EXPECT_EQ(get_param_str_or_def(cell_ref.second.get(), param.ref),
+                          get_param_str_or_def(cell_load, param.load))
+                        << "file: " << file.toStdString() << "\n"
+                        << "cell type: " << id_ICESTORM_HFOSC.str(ctx_norm.get())
+                        << "\nreference cell: " << cell_ref.first.str(ctx_norm.get())
+                        << "\nparameter: "  << param.name;
             }
         }else if(cell_ref.second->type == id_ICESTORM_PLL){
-            for(auto param : pll_params_get()){
-                EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), ctx_norm->id(param.first)),
-                          get_param_or_def(ctx_load.get(), cell_load, ctx_load->id(param.first)))
+            for(auto &param : pll_params){
+                EXPECT_EQ(get_param_or_def(ctx_norm.get(), cell_ref.second.get(), param.ref),
+                          get_param_or_def(ctx_load.get(), cell_load, param.load))
                         << "file: " << file.toStdString() << "\n"
                         << "cell type: " << id_ICESTORM_PLL.str(ctx_norm.get())
                         << "\nreference cell: " << cell_ref.first.str(ctx_norm.get())
-                        << "\nparameter: "  << param.first;
+                        << "\nparameter: "  << param.name;
             }
         }
     }
@@ -417,52 +600,139 @@ void compare_ctx_objects(QString file, char **args, int argv){
     std::stringstream load_write_out;
     write_asc(ctx_load.get(), load_write_out);
 
-    std::unordered_map<std::string, std::vector<std::string>> map;
+    compare_asc(norm_write_out, load_write_out, file);
+}
 
-    std::string key;
-    std::string str_line;
-    while(norm_write_out.good()){
-        getline(norm_write_out, str_line);
-        if(str_line.empty() || str_line.substr(0,4) == ".sym"){
-            continue;
-        }else if(str_line[0] == '.'){
-            key = str_line;
-            ASSERT_TRUE(map.find(key) == map.end())
-                    << "file: " << file.toStdString() << "\n" ;
-            map.insert({key, {}});
-        }else if(!key.empty()){
-            map.at(key).push_back(str_line);
+void place_and_route(Context *ctx){
+    ctx->pack();
+    assign_budget(ctx);
+    ctx->check();
+    ctx->place();
+    ctx->check();
+    ctx->route();
+}
+
+//Checks that the per-net routing state agrees with the wire and pip bindings: every wire of a
+//net is found again by lookup, is bound to that net, and is driven by a bound pip from
+//another wire of the same net
+void check_routing_state(Context *ctx, const QString &file){
+    for(auto &net : ctx->nets){
+        NetInfo *ni = net.second.get();
+        size_t wire_count = 0;
+        for(auto &wire : ni->wires){
+            wire_count++;
+            auto find = ni->wires.find(wire.first);
+            ASSERT_TRUE(find != ni->wires.end() && find->second.pip == wire.second.pip)
+                    << "file: " << file.toStdString() << "\n"
+                    << "wire lookup mismatch in net " << net.first.str(ctx);
+            ASSERT_EQ(ctx->getBoundWireNet(wire.first), ni)
+                    << "file: " << file.toStdString() << "\n"
+                    << "wire " << ctx->getWireName(wire.first).str(ctx) << " not bound to net " << net.first.str(ctx);
+            PipId pip = wire.second.pip;
+            if(pip == PipId())
+                continue;
+            ASSERT_EQ(ctx->getPipDstWire(pip), wire.first)
+                    << "file: " << file.toStdString() << "\n"
+                    << "pip " << ctx->getPipName(pip).str(ctx) << " does not drive its wire";
+            ASSERT_EQ(ctx->getBoundPipNet(pip), ni)
+                    << "file: " << file.toStdString() << "\n"
+                    << "pip " << ctx->getPipName(pip).str(ctx) << " not bound to net " << net.first.str(ctx);
+            ASSERT_TRUE(ni->wires.count(ctx->getPipSrcWire(pip)))
+                    << "file: " << file.toStdString() << "\n"
+                    << "pip " << ctx->getPipName(pip).str(ctx) << " source wire not in net " << net.first.str(ctx);
         }
+        ASSERT_EQ(wire_count, ni->wires.size()) << "file: " << file.toStdString() << "\n"
+                                                << "net " << net.first.str(ctx);
     }
-    size_t line = 0;
-    key = "";
-    while(load_write_out.good()){
-        getline(load_write_out, str_line);
-        if(str_line.empty() || str_line.substr(0,4) == ".sym"){
-            continue;
-        }else if(str_line[0] == '.'){
-            if(map.find(key) != map.end()){
-                ASSERT_EQ(map.find(key)->second.size(), line)
-                        << "file: " << file.toStdString() << "\n" ;
-                map.erase(key);
-            }
-            key = str_line;
-            ASSERT_FALSE(map.find(key) == map.end()) << "file: " << file.toStdString() << "\n"
-                                                     << "could not find \"" << key << "\" in reference file";
-            line = 0;
-        }else if(!key.empty()){
-            ASSERT_EQ(str_line, map.find(key)->second.at(line))
-                    << "file: " << file.toStdString() << "\n" ;
-            line++;
+}
+
+//Checks that cells and nets are stored under their own names and that every cell/net pointer
+//held by a port or port reference points at the object stored in the context
+void check_netlist_refs(Context *ctx, const QString &file){
+    for(auto &net : ctx->nets){
+        NetInfo *ni = net.second.get();
+        ASSERT_EQ(net.first, ni->name) << "file: " << file.toStdString() << "\n"
+                                       << "net stored under wrong name " << net.first.str(ctx);
+        std::vector<PortRef> refs = ni->users;
+        if(ni->driver.cell)
+            refs.push_back(ni->driver);
+        for(auto &ref : refs){
+            if(!ref.cell)
+                continue;
+            auto cell = ctx->cells.find(ref.cell->name);
+            ASSERT_TRUE(cell != ctx->cells.end() && cell->second.get() == ref.cell)
+                    << "file: " << file.toStdString() << "\n"
+                    << "net " << net.first.str(ctx) << " refers to a cell not owned by the context";
+            auto port = ref.cell->ports.find(ref.port);
+            ASSERT_TRUE(port != ref.cell->ports.end() && port->second.net == ni)
+                    << "file: " << file.toStdString() << "\n"
+                    << "net " << net.first.str(ctx) << " not connected to port " << ref.port.str(ctx)
+                    << " of cell " << ref.cell->name.str(ctx);
+        }
+    }
+    for(auto &cell : ctx->cells){
+        ASSERT_EQ(cell.first, cell.second->name) << "file: " << file.toStdString() << "\n"
+                                                 << "cell stored under wrong name " << cell.first.str(ctx);
+        for(auto &port : cell.second->ports){
+            if(!port.second.net)
+                continue;
+            auto net = ctx->nets.find(port.second.net->name);
+            ASSERT_TRUE(net != ctx->nets.end() && net->second.get() == port.second.net)
+                    << "file: " << file.toStdString() << "\n"
+                    << "port " << port.first.str(ctx) << " of cell " << cell.first.str(ctx)
+                    << " refers to a net not owned by the context";
         }
     }
-    if(map.find(key) != map.end()){
-        ASSERT_EQ(map.find(key)->second.size(), line)
-                << "file: " << file.toStdString() << "\n" ;
-        map.erase(key);
+}
+
+static uint64_t hash_mix(uint64_t x){
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+//64-bit FNV-1a over the string bytes; unlike std::hash the result is the same for every
+//standard library and build, so hashes can be compared between runs and machines
+static uint64_t hash_str(const std::string &str){
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for(unsigned char c : str){
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
     }
+    return hash_mix(hash);
+}
 
-    ASSERT_TRUE(map.empty()) << "file: " << file.toStdString() << "\n"  << map.begin()->first;
+//Merkle-style hash of the placed and routed design: every cell and net is hashed on its own
+//and the results are summed, so the value does not depend on hash map iteration order
+uint64_t structural_hash(Context *ctx){
+    uint64_t hash = hash_mix(hash_str(ctx->archArgs().package) + ctx->archArgs().type);
+
+    for(auto &cell : ctx->cells){
+        uint64_t cell_hash = hash_str(cell.first.str(ctx));
+        cell_hash = hash_mix(cell_hash + hash_str(cell.second->type.str(ctx)));
+        cell_hash = hash_mix(cell_hash + cell.second->bel.index);
+        uint64_t params_hash = 0;
+        for(auto &param : cell.second->params)
+            params_hash += hash_mix(hash_str(param.first.str(ctx)) + hash_str(param.second.to_string()));
+        hash += hash_mix(cell_hash + params_hash);
+    }
 
+    for(auto &net : ctx->nets){
+        uint64_t net_hash = hash_str(net.first.str(ctx));
+        const PortRef &driver = net.second->driver;
+        if(driver.cell)
+            net_hash = hash_mix(net_hash + hash_str(driver.cell->name.str(ctx)) + hash_str(driver.port.str(ctx)));
+        uint64_t users_hash = 0;
+        for(auto &user : net.second->users){
+            if(user.cell)
+                users_hash += hash_mix(hash_str(user.cell->name.str(ctx)) + hash_str(user.port.str(ctx)));
+        }
+        uint64_t wires_hash = 0;
+        for(auto &wire : net.second->wires)
+            wires_hash += hash_mix(hash_mix(wire.first.index) + wire.second.pip.index);
+        hash += hash_mix(net_hash + hash_mix(users_hash) + hash_mix(wires_hash));
+    }
 
+    return hash;
 }
@@ -18,89 +18,40 @@
  *
  */
 
-#include <vector>
 #include "gtest/gtest.h"
 #include "nextpnr.h"
 
+#include "arch_checks.h"
+
 USING_NEXTPNR_NAMESPACE
 
-class LP384Test : public ::testing::Test
+struct LP384
 {
-  protected:
-    virtual void SetUp()
+    static ArchArgs args()
     {
+        ArchArgs chipArgs;
         chipArgs.type = ArchArgs::LP384;
         chipArgs.package = "qn32";
-        ctx = new Context(chipArgs);
+        return chipArgs;
     }
+};
 
-    virtual void TearDown() { delete ctx; }
+using LP384Test = DeviceTest<LP384>;
 
-    ArchArgs chipArgs;
-    Context *ctx;
-};
+TEST_F(LP384Test, bel_names) { check_bel_names(ctx, 449); }
 
-TEST_F(LP384Test, bel_names)
-{
-    int bel_count = 0;
-    for (auto bel : ctx->getBels()) {
-        auto name = ctx->getBelName(bel);
-        ASSERT_EQ(bel, ctx->getBelByName(name));
-        bel_count++;
-    }
-    ASSERT_EQ(bel_count, 449);
-}
+TEST_F(LP384Test, wire_names) { check_wire_names(ctx, 9830); }
 
-TEST_F(LP384Test, wire_names)
-{
-    int wire_count = 0;
-    for (auto wire : ctx->getWires()) {
-        auto name = ctx->getWireName(wire);
-        assert(wire == ctx->getWireByName(name));
-        wire_count++;
-    }
-    ASSERT_EQ(wire_count, 9830);
-}
+TEST_F(LP384Test, pip_names) { check_pip_names(ctx, 94544); }
 
-TEST_F(LP384Test, pip_names)
-{
-    int pip_count = 0;
-    for (auto pip : ctx->getPips()) {
-        auto name = ctx->getPipName(pip);
-        assert(pip == ctx->getPipByName(name));
-        pip_count++;
-    }
-    ASSERT_EQ(pip_count, 94544);
-}
+TEST_F(LP384Test, unknown_names) { check_unknown_names(ctx); }
 
-TEST_F(LP384Test, uphill_to_downhill)
-{
-    for (auto dst : ctx->getWires()) {
-        for (auto uphill_pip : ctx->getPipsUphill(dst)) {
-            bool found_downhill = false;
-            for (auto downhill_pip : ctx->getPipsDownhill(ctx->getPipSrcWire(uphill_pip))) {
-                if (uphill_pip == downhill_pip) {
-                    ASSERT_FALSE(found_downhill);
-                    found_downhill = true;
-                }
-            }
-            ASSERT_TRUE(found_downhill);
-        }
-    }
-}
+TEST_F(LP384Test, bel_pins) { check_bel_pins(ctx); }
 
-TEST_F(LP384Test, downhill_to_uphill)
-{
-    for (auto dst : ctx->getWires()) {
-        for (auto downhill_pip : ctx->getPipsDownhill(dst)) {
-            bool found_uphill = false;
-            for (auto uphill_pip : ctx->getPipsUphill(ctx->getPipDstWire(downhill_pip))) {
-                if (uphill_pip == downhill_pip) {
-                    ASSERT_FALSE(found_uphill);
-                    found_uphill = true;
-                }
-            }
-            ASSERT_TRUE(found_uphill);
-        }
-    }
-}
+TEST_F(LP384Test, pips_downhill) { check_pips_downhill(ctx, 94544); }
+
+TEST_F(LP384Test, pips_uphill) { check_pips_uphill(ctx, 94544); }
+
+TEST_F(LP384Test, uphill_to_downhill) { check_uphill_to_downhill(ctx); }
+
+TEST_F(LP384Test, downhill_to_uphill) { check_downhill_to_uphill(ctx); }
@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""
+Compare a perf report against a recorded baseline.
+
+Both files are in the format written by perf_report.py. Every metric that
+is present in the baseline is compared against the current run and a table
+is printed. The exit code is non-zero if a design failed, is missing from
+the current run, or if any metric got worse than the baseline by more than
+the allowed relative tolerance.
+"""
+
+import argparse
+import json
+import sys
+
+# metric name -> True if a higher value is better
+METRICS = {
+    "wall_s": False,
+    "cpu_s": False,
+    "peak_rss_kb": False,
+    "worst_fmax": True,
+    "placer_wirelen": False,
+}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("baseline", help="baseline perf report (JSON)")
+    parser.add_argument("current", help="current perf report (JSON)")
+    parser.add_argument("--tolerance", type=float, default=0.1,
+                        help="allowed relative regression for all metrics (default: 0.1)")
+    parser.add_argument("--metric-tolerance", action="append", default=[], metavar="METRIC=TOL",
+                        help="override the tolerance of a single metric, e.g. wall_s=0.25")
+    args = parser.parse_args()
+
+    tolerance = {metric: args.tolerance for metric in METRICS}
+    for override in args.metric_tolerance:
+        metric, _, value = override.partition("=")
+        if metric not in METRICS or not value:
+            sys.exit("invalid --metric-tolerance: {}".format(override))
+        tolerance[metric] = float(value)
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+    with open(args.current) as f:
+        current = json.load(f)
+
+    failed = False
+    row = "{:<28} {:<12} {:>14} {:>14} {:>9}  {}"
+    print(row.format("design", "metric", "baseline", "current", "change", "result"))
+    for design in sorted(baseline):
+        result = current.get(design)
+        if result is None:
+            print(row.format(design, "-", "-", "-", "-", "MISSING"))
+            failed = True
+            continue
+        if result.get("status", 0) != 0:
+            print(row.format(design, "status", "0", result["status"], "-", "FAILED"))
+            failed = True
+            continue
+        for metric, higher_is_better in METRICS.items():
+            if metric not in baseline[design]:
+                continue
+            base = baseline[design][metric]
+            if metric not in result:
+                print(row.format(design, metric, base, "-", "-", "MISSING"))
+                failed = True
+                continue
+            value = result[metric]
+            change = (value - base) / base if base else 0.0
+            regression = -change if higher_is_better else change
+            ok = regression <= tolerance[metric]
+            failed = failed or not ok
+            print(row.format(design, metric, base, value, "{:+.1%}".format(change), "ok" if ok else "REGRESSED"))
+
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
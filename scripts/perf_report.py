@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""
+Collect per-design performance numbers from a regression run.
+
+For every design given on the command line (as a path without extension,
+e.g. issue0183/TopEntity) this reads the files the regression Makefiles
+write next to the design:
+  <design>.time    "<wall s> <user s> <sys s> <peak RSS KiB>" from GNU time
+  <design>.status  "<exit status> <wall s>"
+  <design>.log     nextpnr output, scanned for phase times, Fmax and the placer's
+                   estimated wirelength
+and prints one JSON object keyed by design. Missing files are skipped, so
+the report works for partial runs.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+# Matches e.g. "SA placement time 1.23s", "Router1 time 4.56s" and "HeAP Placer Time: 1.23s"
+PHASE_TIME = re.compile(r"(?i)^Info: (?P<phase>[A-Za-z0-9 ]+?) time:? (?P<seconds>[0-9.]+)s\b")
+FMAX = re.compile(r"Max frequency for clock '(?P<clock>[^']*)': (?P<fmax>[0-9.]+) MHz")
+# The placer's half-perimeter estimate; nextpnr does not log a post-route wirelength
+PLACER_WIRELEN = re.compile(r"wirelen = (?P<wirelen>[0-9]+)")
+
+
+def read_fields(filename):
+    # GNU time prefixes its output with a line about non-zero exit codes, the numbers are on the last line
+    if not os.path.exists(filename):
+        return None
+    with open(filename) as f:
+        lines = [line for line in f.read().splitlines() if line.strip()]
+    return lines[-1].split() if lines else None
+
+
+def parse_log(filename, result):
+    if not os.path.exists(filename):
+        return
+    phases = {}
+    fmax = {}
+    wirelen = None
+    with open(filename) as f:
+        for line in f:
+            m = PHASE_TIME.match(line)
+            if m:
+                phases[m.group("phase")] = phases.get(m.group("phase"), 0.0) + float(m.group("seconds"))
+            # Fmax and wirelength are reported several times, the last value is the final one
+            m = FMAX.search(line)
+            if m:
+                fmax[m.group("clock")] = float(m.group("fmax"))
+            m = PLACER_WIRELEN.search(line)
+            if m:
+                wirelen = int(m.group("wirelen"))
+    if phases:
+        result["phases"] = phases
+    if fmax:
+        result["fmax"] = fmax
+        result["worst_fmax"] = min(fmax.values())
+    if wirelen is not None:
+        result["placer_wirelen"] = wirelen
+
+
+def collect(design):
+    result = {}
+    fields = read_fields(design + ".time")
+    if fields and len(fields) >= 4:
+        result["wall_s"] = float(fields[0])
+        result["cpu_s"] = float(fields[1]) + float(fields[2])
+        result["peak_rss_kb"] = int(fields[3])
+    fields = read_fields(design + ".status")
+    if fields:
+        result["status"] = int(fields[0])
+        result.setdefault("wall_s", float(fields[1]))
+    parse_log(design + ".log", result)
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("designs", nargs="*", help="design paths without extension")
+    args = parser.parse_args()
+
+    report = {design: collect(design) for design in args.designs}
+    json.dump(report, sys.stdout, indent=2, sort_keys=True)
+    sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()
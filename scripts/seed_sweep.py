@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""
+Summarise a regression seed sweep.
+
+Takes the nextpnr logs written by `make sweep` (named <design>_seed<N>.log)
+and prints a JSON report with the exit status and achieved Fmax of every
+seed, plus the best seed per design. The best seed is the successful run
+with the highest worst-case Fmax over all clocks; designs without clocks
+pick the lowest successful seed.
+"""
+
+import argparse
+import json
+import re
+import sys
+
+LOG_NAME = re.compile(r"^(?P<design>.*)_seed(?P<seed>\d+)\.log$")
+FMAX = re.compile(r"Max frequency for clock '(?P<clock>[^']*)': (?P<fmax>[0-9.]+) MHz")
+STATUS = re.compile(r"^Exit status: (?P<status>\d+)$")
+
+
+def parse_log(filename):
+    # Fmax is reported after placement and again after routing, keep the last value per clock
+    fmax = {}
+    status = None
+    with open(filename) as f:
+        for line in f:
+            m = FMAX.search(line)
+            if m:
+                fmax[m.group("clock")] = float(m.group("fmax"))
+            m = STATUS.match(line.strip())
+            if m:
+                status = int(m.group("status"))
+    result = {"status": status, "fmax": fmax}
+    if fmax:
+        result["worst_fmax"] = min(fmax.values())
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("logs", nargs="+", help="<design>_seed<N>.log files")
+    args = parser.parse_args()
+
+    designs = {}
+    for filename in args.logs:
+        m = LOG_NAME.match(filename)
+        if not m:
+            sys.exit("unexpected log file name: {}".format(filename))
+        seeds = designs.setdefault(m.group("design"), {})
+        seeds[int(m.group("seed"))] = parse_log(filename)
+
+    report = {}
+    for design, seeds in sorted(designs.items()):
+        passing = [seed for seed, result in sorted(seeds.items()) if result["status"] == 0]
+        best = None
+        if passing:
+            best = max(passing, key=lambda seed: (seeds[seed].get("worst_fmax", 0.0), -seed))
+        report[design] = {
+            "seeds": {str(seed): result for seed, result in sorted(seeds.items())},
+            "best_seed": best,
+        }
+
+    json.dump(report, sys.stdout, indent=2, sort_keys=True)
+    sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()